@@ -3,6 +3,9 @@
 #include <vector>
 #include <string>
 #include <unordered_map>
+#include <atomic>
+#include <chrono>
+#include <functional>
 #include <Eigen/Dense>
 
 // Assimp 前向声明
@@ -27,6 +30,22 @@ struct Edge {
     }
 };
 
+// 属性感知 QEM 使用的边，额外记录坍塌后的最优法线与 UV；纯几何路径仍使用 Edge
+struct AttrEdge : Edge {
+    AttrVec targetAttr;
+    int version1 = 0, version2 = 0; // 计算代价时两端点的坍塌版本，用于识别过期的边
+};
+
+// 简化引擎：QEM 为逐边贪心坍塌；Clustering 为 O(n) 顶点聚类，用于最低级 LOD / 预览
+enum class SimplifyEngine {
+    QEM,
+    Clustering
+};
+
+// 进度回调：phase 为当前阶段名 ("load", "topology", "quadrics", "collapse", "cluster", "writeback")，
+// fraction 为该阶段的完成比例 [0, 1]。回调在调用 simplify 的线程上执行
+using ProgressCallback = std::function<void(const std::string& phase, double fraction)>;
+
 class MACSimplifier {
 public:
     MACSimplifier();
@@ -37,9 +56,28 @@ public:
     double w_uv_base;
     double w_boundary;
 
+    SimplifyEngine engine;
+    // 聚类网格每轴的格子数，0 表示根据 ratio 自动拟合
+    int clusterGridResolution;
+    // 聚类时是否额外保护几何边界 (需要焊接拓扑，较慢)
+    bool clusterPreserveBoundary;
+
+    // 墙钟时间预算 (秒)，<= 0 表示不限时。预算从 simplify 开始计时，在拓扑、二次误差、建边与坍塌阶段检查，
+    // 耗尽后停止并输出当前结果；读取 scene 与 writeBack 不可中断，总耗时会超出预算这两步的时间。
+    // QEM 的预处理超过剩余预算的一半时放弃 QEM，改用剩余时间跑 O(n) 顶点聚类，避免预算全耗在预处理上
+    double timeBudgetSeconds;
+    ProgressCallback onProgress;
+
     // 修改：接收 Assimp 的 aiScene 指针
     // 注意：我们会直接修改 scene 中的 mesh 数据
-    void simplify(const aiScene* scene, double ratio);
+    // cancelToken 由调用方持有，可在任意线程置为 true 请求本次调用尽快停止 (已完成的坍塌仍会写回 scene)；
+    // simplify 只读取它，从不清除，因此在工作线程真正进入 simplify 之前发出的取消同样有效
+    void simplify(const aiScene* scene, double ratio, const std::atomic<bool>* cancelToken = nullptr);
+
+    // 上一次 simplify 实际达到的减面比例 (1 - 输出面数 / 输入面数)
+    double getAchievedRatio() const { return achievedRatio; }
+    // 上一次 simplify 是否因取消或时间预算耗尽而提前停止
+    bool wasInterrupted() const { return interrupted; }
 
 private:
     std::vector<Vertex> vertices;
@@ -53,8 +91,13 @@ private:
         Quadric q;
         std::vector<int> originalIndices;
         bool removed = false;
+        AttrVec attr;       // 法线 + UV
+        bool seam = false;  // 同一位置存在多组属性 (法线硬边 / UV 接缝)，此时保留各原始顶点的属性
     };
     std::vector<UniqueVertex> uniqueVertices;
+    // 属性扩展二次误差矩阵，仅在启用属性约束时分配，与 uniqueVertices 一一对应；
+    // 启用时几何与边界误差也直接累加在这里，UniqueVertex::q 不再维护
+    std::vector<AttrQuadric> attrQuadrics;
     std::vector<int> uniqueIndices;
 
     // 记录原始 Mesh 归属，用于回写
@@ -64,13 +107,26 @@ private:
         int indexCount;    // 索引数量
     };
     std::vector<MeshRef> meshGroups;
-    std::unordered_map<int, int> globalFaceToMeshID;
+
+    const std::atomic<bool>* cancelToken;
+    std::chrono::steady_clock::time_point deadline;
+    std::chrono::steady_clock::time_point setupDeadline; // QEM 预处理的截止时间，超过后回退到聚类
+    bool inSetup;
+    bool setupExpired;
+    double achievedRatio;
+    bool interrupted;
 
     // 辅助函数
     void loadData(const aiScene* scene);
     void buildUniqueTopology();
     void computeQuadrics();
+    void addBoundaryQuadrics(const std::function<void(int, const Quadric&)>& addTo);
     void runSimplification(double ratio);
+    void runClustering(double ratio);
     void writeBack(const aiScene* scene);
+    bool shouldStop();
+    bool useAttributeQuadrics() const;
+    AttrVec wedgeAttr(int gid) const;
+    void reportProgress(const char* phase, double fraction);
     void clear();
 };
\ No newline at end of file
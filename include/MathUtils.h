@@ -35,4 +35,63 @@ struct Quadric {
 
     // 求解最佳位置: 求解线性方程组来找到误差最小的点
     bool optimize(Vec3& result) const;
+};
+
+// --- 压缩存储的几何二次误差 ---
+// 只存 4x4 对称矩阵上三角的 10 个系数，用作聚类时每线程的累加器
+struct PackedQuadric {
+    double a[10] = {};
+
+    // 根据平面构建: n·p + d = 0，乘以权重 w
+    static PackedQuadric FromPlane(const Vec3& n, double d, double w);
+    PackedQuadric& operator+=(const PackedQuadric& b);
+    Quadric toQuadric() const;
+};
+
+// 属性维度：法线 (3) + UV (2)
+constexpr int kAttrDim = 5;
+using AttrVec = Eigen::Matrix<double, kAttrDim, 1>;
+
+// --- 属性扩展二次误差矩阵 (Attribute Quadric) ---
+// 作用于扩展向量 x = (p, s, 1)：p 为位置，s 为属性 (法线 + UV)
+// 对称矩阵只按行存储上三角，9x9 共 45 个 double，代价计算为单次融合循环
+struct AttrQuadric {
+    static constexpr int N = 3 + kAttrDim + 1;
+    static constexpr int PackedSize = N * (N + 1) / 2;
+    using VecN = Eigen::Matrix<double, N, 1>;
+
+    double a[PackedSize];
+
+    // 上三角 (i <= j) 元素在压缩数组中的位置
+    static constexpr int index(int i, int j) { return i * N - i * (i - 1) / 2 + (j - i); }
+
+    AttrQuadric();
+
+    void setZero();
+
+    AttrQuadric operator+(const AttrQuadric& b) const;
+    AttrQuadric& operator+=(const AttrQuadric& b);
+
+    // 累加秩一项 w * (c^T x)^2
+    void addRank1(const VecN& c, double w);
+
+    // 合入几何 Quadric (位置块与常数项)
+    void addGeometric(const Quadric& q);
+
+    // 计算 x^T * Q * x
+    double evaluate(const Vec3& p, const AttrVec& s) const;
+
+    // 消去属性块后的约化形式 (一次 5x5 分解)：
+    // 固定位置 p 时最优属性为 X p + y，联合最优位置满足 S p = r
+    struct Reduced {
+        Eigen::Matrix<double, kAttrDim, 3> X;
+        AttrVec y;
+        Eigen::Matrix3d S;
+        Vec3 r;
+        bool valid = false;
+
+        AttrVec attributesAt(const Vec3& p) const { return X * p + y; }
+        bool optimize(Vec3& p, AttrVec& s) const;
+    };
+    Reduced reduce() const;
 };
\ No newline at end of file
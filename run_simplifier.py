@@ -38,7 +38,7 @@ def deploy_dlls(exe_path):
             found_path = find_in_path(dll)
             if found_path: shutil.copy2(found_path, dst_path)
 
-def run_simplification(exe_path, input_model, output_model, ratio, w_norm=0.1, w_uv=0.1, w_boundary=10000.0):
+def run_simplification(exe_path, input_model, output_model, ratio, w_norm=0.1, w_uv=0.1, w_boundary=10000.0, engine="qem", time_budget=0.0):
     if not os.path.exists(exe_path):
         print(f"Error: Executable not found at {exe_path}")
         return
@@ -58,7 +58,9 @@ def run_simplification(exe_path, input_model, output_model, ratio, w_norm=0.1, w
         str(ratio),
         str(w_norm),
         str(w_uv),
-        str(w_boundary)
+        str(w_boundary),
+        engine,
+        str(time_budget)
     ]
 
     print(f"[Python] Executing C++ Core: {' '.join(cmd)}")
@@ -2,10 +2,13 @@
 #include "../include/MathUtils.h"
 #include <iostream>
 #include <set>
+#include <unordered_set>
 #include <algorithm>
 #include <vector>
 #include <cmath>
 #include <map>
+#include <thread>
+#include <limits>
 
 #include <assimp/scene.h>
 #include <assimp/mesh.h>
@@ -51,17 +54,160 @@ bool Quadric::optimize(Vec3& result) const {
     return true;
 }
 
+PackedQuadric PackedQuadric::FromPlane(const Vec3& n, double d, double w) {
+    PackedQuadric q;
+    double p[4] = {n.x(), n.y(), n.z(), d};
+    int k = 0;
+    for (int i = 0; i < 4; ++i) {
+        for (int j = i; j < 4; ++j) q.a[k++] = w * p[i] * p[j];
+    }
+    return q;
+}
+
+PackedQuadric& PackedQuadric::operator+=(const PackedQuadric& b) {
+    for (int k = 0; k < 10; ++k) a[k] += b.a[k];
+    return *this;
+}
+
+Quadric PackedQuadric::toQuadric() const {
+    Quadric q;
+    int k = 0;
+    for (int i = 0; i < 4; ++i) {
+        for (int j = i; j < 4; ++j) {
+            q.A(i, j) = a[k];
+            q.A(j, i) = a[k];
+            ++k;
+        }
+    }
+    return q;
+}
+
+AttrQuadric::AttrQuadric() { setZero(); }
+void AttrQuadric::setZero() { std::fill(a, a + PackedSize, 0.0); }
+AttrQuadric AttrQuadric::operator+(const AttrQuadric& b) const { AttrQuadric r = *this; r += b; return r; }
+AttrQuadric& AttrQuadric::operator+=(const AttrQuadric& b) {
+    for (int k = 0; k < PackedSize; ++k) a[k] += b.a[k];
+    return *this;
+}
+
+void AttrQuadric::addRank1(const VecN& c, double w) {
+    int k = 0;
+    for (int i = 0; i < N; ++i) {
+        double wc = w * c[i];
+        for (int j = i; j < N; ++j) a[k++] += wc * c[j];
+    }
+}
+
+void AttrQuadric::addGeometric(const Quadric& q) {
+    // 几何下标 (x, y, z, 1) 映射到扩展下标 (0, 1, 2, N-1)，顺序不变，仍落在上三角
+    const int map[4] = {0, 1, 2, N - 1};
+    for (int i = 0; i < 4; ++i) {
+        for (int j = i; j < 4; ++j) {
+            a[index(map[i], map[j])] += q.A(i, j);
+        }
+    }
+}
+
+double AttrQuadric::evaluate(const Vec3& p, const AttrVec& s) const {
+    double x[N];
+    x[0] = p.x(); x[1] = p.y(); x[2] = p.z();
+    for (int i = 0; i < kAttrDim; ++i) x[3 + i] = s[i];
+    x[N - 1] = 1.0;
+
+    // x^T Q x = sum_i x_i * (Q_ii * x_i + 2 * sum_{j>i} Q_ij * x_j)
+    double r = 0.0;
+    int k = 0;
+    for (int i = 0; i < N; ++i) {
+        double row = 0.5 * a[k++] * x[i];
+        for (int j = i + 1; j < N; ++j) row += a[k++] * x[j];
+        r += row * x[i];
+    }
+    return 2.0 * r;
+}
+
+AttrQuadric::Reduced AttrQuadric::reduce() const {
+    // 直接从压缩数组取各块，避免展开完整矩阵
+    Eigen::Matrix3d App;
+    Eigen::Matrix<double, 3, kAttrDim> Aps;
+    Eigen::Matrix<double, kAttrDim, kAttrDim> Ass;
+    Vec3 bp;
+    AttrVec bs;
+    for (int i = 0; i < 3; ++i) {
+        for (int j = i; j < 3; ++j) App(i, j) = App(j, i) = a[index(i, j)];
+        for (int j = 0; j < kAttrDim; ++j) Aps(i, j) = a[index(i, 3 + j)];
+        bp[i] = a[index(i, N - 1)];
+    }
+    for (int i = 0; i < kAttrDim; ++i) {
+        for (int j = i; j < kAttrDim; ++j) Ass(i, j) = Ass(j, i) = a[index(3 + i, 3 + j)];
+        bs[i] = a[index(3 + i, N - 1)];
+    }
+
+    // 属性块由带正权重的属性项构成，是正定的
+    Reduced R;
+    Eigen::LLT<Eigen::Matrix<double, kAttrDim, kAttrDim>> solver(Ass);
+    if (solver.info() != Eigen::Success) return R;
+    R.X = -solver.solve(Aps.transpose());
+    R.y = -solver.solve(bs);
+    R.S = App + Aps * R.X;
+    R.r = -(bp + Aps * R.y);
+    R.valid = true;
+    return R;
+}
+
+bool AttrQuadric::Reduced::optimize(Vec3& p, AttrVec& s) const {
+    if (!valid) return false;
+    Eigen::LDLT<Eigen::Matrix3d> solver(S);
+    if (solver.info() != Eigen::Success || solver.rcond() < 1e-6) return false;
+    p = solver.solve(r);
+    s = attributesAt(p);
+    return true;
+}
+
 // ==========================================
 // 3. MACSimplifier Implementation
 // ==========================================
 
-MACSimplifier::MACSimplifier() : w_geo(1.0), w_norm(0.1), w_uv_base(0.1), w_boundary(10000.0) {}
+MACSimplifier::MACSimplifier() : w_geo(1.0), w_norm(0.1), w_uv_base(0.1), w_boundary(10000.0),
+                                 engine(SimplifyEngine::QEM), clusterGridResolution(0), clusterPreserveBoundary(false),
+                                 timeBudgetSeconds(0.0), cancelToken(nullptr), inSetup(false), setupExpired(false),
+                                 achievedRatio(0.0), interrupted(false) {}
 MACSimplifier::~MACSimplifier() {}
 
+// 时间预算 / 取消检查的间隔 (循环迭代次数)，避免每次迭代都读时钟
+static const int kStopCheckInterval = 1024;
+
+bool MACSimplifier::shouldStop() {
+    if (interrupted || setupExpired) return true;
+    bool budgeted = timeBudgetSeconds > 0.0;
+    auto now = budgeted ? std::chrono::steady_clock::now() : std::chrono::steady_clock::time_point();
+    if ((cancelToken && cancelToken->load(std::memory_order_relaxed)) || (budgeted && now >= deadline)) {
+        interrupted = true;
+    } else if (inSetup && budgeted && now >= setupDeadline) {
+        // 只中止 QEM 预处理，由 simplify 改走聚类
+        setupExpired = true;
+    }
+    return interrupted || setupExpired;
+}
+
+void MACSimplifier::reportProgress(const char* phase, double fraction) {
+    if (onProgress) onProgress(phase, std::min(1.0, std::max(0.0, fraction)));
+}
+
 void MACSimplifier::clear() {
     vertices.clear(); indices.clear(); normals.clear(); uvs.clear();
-    meshGroups.clear(); globalFaceToMeshID.clear();
-    uniqueVertices.clear(); uniqueIndices.clear();
+    meshGroups.clear();
+    uniqueVertices.clear(); uniqueIndices.clear(); attrQuadrics.clear();
+}
+
+// 属性约束只作用于 QEM 引擎，权重全为 0 时退化为纯几何 QEM
+bool MACSimplifier::useAttributeQuadrics() const {
+    return engine == SimplifyEngine::QEM && (w_norm > 0.0 || w_uv_base > 0.0);
+}
+
+AttrVec MACSimplifier::wedgeAttr(int gid) const {
+    AttrVec s;
+    s << normals[gid], uvs[gid];
+    return s;
 }
 
 // --- 仅基于位置的 Key (Position Only) ---
@@ -76,6 +222,12 @@ struct AttributeVertexKey {
     }
 };
 
+// 无向边 (u < v) 打包为 64 位键，用于哈希表统计
+inline int64_t edge_key(int u, int v) {
+    if (u > v) std::swap(u, v);
+    return ((int64_t)u << 32) | (uint32_t)v;
+}
+
 AttributeVertexKey make_key(const Vertex& v) {
     // 精度控制：10000.0 意味着 0.1mm 的误差内视为同一点
     const double posScale = 10000.0;
@@ -86,21 +238,97 @@ AttributeVertexKey make_key(const Vertex& v) {
     };
 }
 
-void MACSimplifier::simplify(const aiScene* scene, double ratio) {
+// parallel_for 对 n 个元素使用的线程数，数据量太小时只用当前线程；maxWorkers 用于限制每线程累加器的总内存
+static int parallel_workers(int n, int maxWorkers = std::numeric_limits<int>::max()) {
+    const int minChunk = 4096;
+    int numThreads = (int)std::max(1u, std::thread::hardware_concurrency());
+    return std::max(1, std::min({numThreads, (n + minChunk - 1) / minChunk, maxWorkers}));
+}
+
+// 将 [0, n) 均分给 parallel_workers(n) 个线程执行，fn(worker, begin, end) 中 worker 为线程序号，
+// 可用于索引每线程独立的累加器
+template <typename Fn>
+static void parallel_for(int n, Fn fn, int maxWorkers = std::numeric_limits<int>::max()) {
+    int numThreads = parallel_workers(n, maxWorkers);
+    if (numThreads <= 1) { fn(0, 0, n); return; }
+
+    std::vector<std::thread> workers;
+    int chunk = (n + numThreads - 1) / numThreads;
+    for (int t = 0; t < numThreads; ++t) {
+        int begin = t * chunk;
+        int end = std::min(n, begin + chunk);
+        if (begin >= end) break;
+        workers.emplace_back(fn, t, begin, end);
+    }
+    for (auto& w : workers) w.join();
+}
+
+void MACSimplifier::simplify(const aiScene* scene, double ratio, const std::atomic<bool>* cancelToken) {
     clear();
+    achievedRatio = 0.0;
+    interrupted = false;
+    inSetup = false;
+    setupExpired = false;
     if (!scene) return;
+    this->cancelToken = cancelToken;
+
+    auto start = std::chrono::steady_clock::now();
+    deadline = start + std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+            std::chrono::duration<double>(std::max(0.0, timeBudgetSeconds)));
 
     std::cout << "[Info] Loading data from Assimp Scene..." << std::endl;
+    reportProgress("load", 0.0);
     loadData(scene);
+    reportProgress("load", 1.0);
 
     if (indices.empty()) {
         std::cout << "[Warn] No geometry found." << std::endl;
+        this->cancelToken = nullptr;
         return;
     }
 
-    buildUniqueTopology();
-    runSimplification(ratio);
+    // 聚类引擎直接按坐标分格，坐标重合的顶点必然落入同一格子，无需先焊接拓扑
+    if (engine == SimplifyEngine::Clustering) {
+        runClustering(ratio);
+    } else {
+        // 预处理 (焊接、二次误差、建边) 最多使用剩余预算的一半，留出时间给坍塌
+        inSetup = true;
+        auto now = std::chrono::steady_clock::now();
+        setupDeadline = now + (deadline - now) / 2;
+
+        reportProgress("topology", 0.0);
+        buildUniqueTopology();
+        reportProgress("topology", 1.0);
+        if (!shouldStop()) runSimplification(ratio);
+        inSetup = false;
+
+        if (setupExpired && !interrupted) {
+            std::cout << "[Warn] QEM preprocessing used half of the time budget, falling back to vertex clustering." << std::endl;
+            setupExpired = false;
+            uniqueVertices.clear(); uniqueIndices.clear(); attrQuadrics.clear();
+            runClustering(ratio);
+        }
+    }
+
+    if (interrupted) {
+        bool cancelled = cancelToken && cancelToken->load();
+        std::cout << "[Warn] Simplification stopped early ("
+                  << (cancelled ? "cancelled" : "time budget exhausted") << "), writing best mesh so far." << std::endl;
+    }
+    this->cancelToken = nullptr;
+
+    reportProgress("writeback", 0.0);
     writeBack(scene);
+    reportProgress("writeback", 1.0);
+
+    size_t outFaces = 0;
+    for (const auto& ref : meshGroups) outFaces += ref.mesh->mNumFaces;
+    size_t inFaces = indices.size() / 3;
+    achievedRatio = inFaces > 0 ? 1.0 - (double)outFaces / inFaces : 0.0;
+
+    double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    std::cout << "[Info] Faces: " << inFaces << " -> " << outFaces << ", Achieved Ratio: " << achievedRatio
+              << " (requested " << ratio << "), Time: " << elapsed << "s" << std::endl;
 }
 
 void MACSimplifier::loadData(const aiScene* scene) {
@@ -144,12 +372,6 @@ void MACSimplifier::loadData(const aiScene* scene) {
             localIndexCount += 3;
         }
 
-        size_t numNewFaces = localIndexCount / 3;
-        size_t startFace = indices.size() / 3 - numNewFaces;
-        for (size_t i = 0; i < numNewFaces; ++i) {
-            globalFaceToMeshID[startFace + i] = meshGroups.size();
-        }
-
         ref.indexCount = localIndexCount;
         meshGroups.push_back(ref);
         globalOffset += mesh->mNumVertices;
@@ -164,6 +386,8 @@ void MACSimplifier::buildUniqueTopology() {
     uniqueIndices.resize(indices.size());
 
     for (size_t i = 0; i < vertices.size(); ++i) {
+        // 中断时 uniqueIndices 未完成，调用方需检查 shouldStop() 后再使用拓扑
+        if (i % kStopCheckInterval == 0 && shouldStop()) return;
         AttributeVertexKey key = make_key(vertices[i]);
 
         int uid = -1;
@@ -175,10 +399,15 @@ void MACSimplifier::buildUniqueTopology() {
             UniqueVertex uv_struct;
             uv_struct.p = vertices[i].p;
             uv_struct.q.setZero();
+            uv_struct.attr = wedgeAttr(i);
             uniqueVertices.push_back(uv_struct);
             keyMap[key] = uid;
         }
 
+        if (!uniqueVertices[uid].seam && (wedgeAttr(i) - uniqueVertices[uid].attr).squaredNorm() > 1e-10) {
+            uniqueVertices[uid].seam = true;
+        }
+
         vertices[i].uniqueId = uid;
         uniqueVertices[uid].originalIndices.push_back(i);
     }
@@ -190,46 +419,31 @@ void MACSimplifier::buildUniqueTopology() {
     std::cout << "[Info] Topology built. Merged Vertices: " << vertices.size() << " -> " << uniqueVertices.size() << std::endl;
 }
 
-void MACSimplifier::computeQuadrics() {
+// 检测真正的几何边界 (只属于一个面的边)，沿边界生成垂直于面的约束平面，交给 addTo 累加到两个端点
+void MACSimplifier::addBoundaryQuadrics(const std::function<void(int, const Quadric&)>& addTo) {
     int numFaces = uniqueIndices.size() / 3;
-    std::map<std::pair<int, int>, int> edgeCounts;
-
-    std::cout << "[Info] Computing Quadrics (Standard QEM)..." << std::endl;
+    std::unordered_map<int64_t, int> edgeCounts;
+    edgeCounts.reserve(uniqueIndices.size());
 
     for (int i = 0; i < numFaces; ++i) {
+        if (i % kStopCheckInterval == 0 && shouldStop()) return;
         int i0 = uniqueIndices[i * 3];
         int i1 = uniqueIndices[i * 3 + 1];
         int i2 = uniqueIndices[i * 3 + 2];
         if (i0 == i1 || i1 == i2 || i2 == i0) continue;
 
         Vec3 p0 = uniqueVertices[i0].p;
-        Vec3 p1 = uniqueVertices[i1].p;
-        Vec3 p2 = uniqueVertices[i2].p;
-
-        Vec3 crossP = (p1 - p0).cross(p2 - p0);
-        if (crossP.norm() < 1e-12) continue;
-
-        Vec3 n = crossP.normalized();
-        double d = -n.dot(p0);
+        if ((uniqueVertices[i1].p - p0).cross(uniqueVertices[i2].p - p0).norm() < 1e-12) continue;
 
-        Quadric Kp = Quadric::FromPlane(n.x(), n.y(), n.z(), d);
-        Kp = Kp * w_geo;
-
-        uniqueVertices[i0].q += Kp;
-        uniqueVertices[i1].q += Kp;
-        uniqueVertices[i2].q += Kp;
-
-        int e[3][2] = {{i0,i1}, {i1,i2}, {i2,i0}};
-        for(auto& edge : e) {
-            int u=edge[0], v=edge[1];
-            if(u>v) std::swap(u,v);
-            edgeCounts[{u,v}]++;
-        }
+        edgeCounts[edge_key(i0, i1)]++;
+        edgeCounts[edge_key(i1, i2)]++;
+        edgeCounts[edge_key(i2, i0)]++;
     }
 
     // 此时 edgeCount=1 代表真正的几何边界
     int protectedEdges = 0;
     for (int i = 0; i < numFaces; ++i) {
+        if (i % kStopCheckInterval == 0 && shouldStop()) return;
         int idx[3] = {uniqueIndices[i*3], uniqueIndices[i*3+1], uniqueIndices[i*3+2]};
         if (idx[0] == idx[1] || idx[1] == idx[2] || idx[2] == idx[0]) continue;
 
@@ -239,17 +453,16 @@ void MACSimplifier::computeQuadrics() {
         for(int j=0; j<3; ++j) {
             int u = idx[j];
             int v = idx[(j+1)%3];
-            int u_s = u, v_s = v;
-            if(u_s > v_s) std::swap(u_s, v_s);
 
-            if(edgeCounts[{u_s, v_s}] == 1) {
+            auto it = edgeCounts.find(edge_key(u, v));
+            if(it != edgeCounts.end() && it->second == 1) {
                 Vec3 edgeVec = uniqueVertices[v].p - uniqueVertices[u].p;
                 Vec3 borderN = edgeVec.cross(n).normalized();
                 double d = -borderN.dot(uniqueVertices[u].p);
 
                 Quadric Qborder = Quadric::FromPlane(borderN.x(), borderN.y(), borderN.z(), d) * (w_boundary * 10.0);
-                uniqueVertices[u].q += Qborder;
-                uniqueVertices[v].q += Qborder;
+                addTo(u, Qborder);
+                addTo(v, Qborder);
                 protectedEdges++;
             }
         }
@@ -257,21 +470,112 @@ void MACSimplifier::computeQuadrics() {
     std::cout << "[Info] Protected Edges (Real Borders): " << protectedEdges << std::endl;
 }
 
+void MACSimplifier::computeQuadrics() {
+    int numFaces = uniqueIndices.size() / 3;
+
+    bool useAttr = useAttributeQuadrics();
+    std::cout << "[Info] Computing Quadrics (" << (useAttr ? "Attribute-Aware QEM" : "Standard QEM") << ")..." << std::endl;
+
+    // 属性权重换算到模型尺度：法线误差以包围盒对角线为单位，UV 误差再按 UV 包围盒自适应缩放
+    // 权重为 0 的属性仍保留极小权重，使其随坍塌插值而不影响代价
+    double attrWeights[kAttrDim];
+    if (useAttr) {
+        attrQuadrics.assign(uniqueVertices.size(), AttrQuadric());
+
+        Vec3 bmin = uniqueVertices[0].p, bmax = uniqueVertices[0].p;
+        for (const auto& v : uniqueVertices) { bmin = bmin.cwiseMin(v.p); bmax = bmax.cwiseMax(v.p); }
+        Eigen::Vector2d uvMin = uvs[0], uvMax = uvs[0];
+        for (const auto& t : uvs) { uvMin = uvMin.cwiseMin(t); uvMax = uvMax.cwiseMax(t); }
+
+        double diag = std::max((bmax - bmin).norm(), 1e-12);
+        double uvDiag = (uvMax - uvMin).norm();
+        double uvScale = uvDiag > 1e-12 ? diag / uvDiag : diag;
+        double minWeight = 1e-8 * diag * diag;
+        double wn = std::max(w_norm * diag * diag, minWeight);
+        double wt = std::max(w_uv_base * uvScale * uvScale, minWeight);
+        for (int k = 0; k < 3; ++k) attrWeights[k] = wn;
+        for (int k = 3; k < kAttrDim; ++k) attrWeights[k] = wt;
+    }
+
+    for (int i = 0; i < numFaces; ++i) {
+        if (i % kStopCheckInterval == 0 && shouldStop()) return;
+        int i0 = uniqueIndices[i * 3];
+        int i1 = uniqueIndices[i * 3 + 1];
+        int i2 = uniqueIndices[i * 3 + 2];
+        if (i0 == i1 || i1 == i2 || i2 == i0) continue;
+
+        Vec3 p0 = uniqueVertices[i0].p;
+        Vec3 p1 = uniqueVertices[i1].p;
+        Vec3 p2 = uniqueVertices[i2].p;
+
+        Vec3 crossP = (p1 - p0).cross(p2 - p0);
+        if (crossP.norm() < 1e-12) continue;
+
+        Vec3 n = crossP.normalized();
+        double d = -n.dot(p0);
+
+        Quadric Kp = Quadric::FromPlane(n.x(), n.y(), n.z(), d);
+        Kp = Kp * w_geo;
+
+        if (!useAttr) {
+            uniqueVertices[i0].q += Kp;
+            uniqueVertices[i1].q += Kp;
+            uniqueVertices[i2].q += Kp;
+        } else {
+            // 求面内属性的线性插值 s(p) = g·p + d：三个角点插值，且沿面法线方向梯度为 0
+            // 每个属性分量贡献秩一项 w * (g·p + d - s)^2
+            Eigen::Matrix4d M;
+            M << p0.transpose(), 1.0,
+                 p1.transpose(), 1.0,
+                 p2.transpose(), 1.0,
+                 n.transpose(), 0.0;
+            Eigen::Matrix<double, 4, kAttrDim> S;
+            S.row(0) = wedgeAttr(indices[i * 3]).transpose();
+            S.row(1) = wedgeAttr(indices[i * 3 + 1]).transpose();
+            S.row(2) = wedgeAttr(indices[i * 3 + 2]).transpose();
+            S.row(3).setZero();
+            Eigen::Matrix<double, 4, kAttrDim> G = M.partialPivLu().solve(S);
+
+            AttrQuadric Ka;
+            Ka.addGeometric(Kp);
+            for (int k = 0; k < kAttrDim; ++k) {
+                AttrQuadric::VecN c = AttrQuadric::VecN::Zero();
+                c.head<3>() = G.col(k).head<3>();
+                c[3 + k] = -1.0;
+                c[AttrQuadric::N - 1] = G(3, k);
+                Ka.addRank1(c, attrWeights[k]);
+            }
+            attrQuadrics[i0] += Ka;
+            attrQuadrics[i1] += Ka;
+            attrQuadrics[i2] += Ka;
+        }
+    }
+
+    if (shouldStop()) return;
+    if (useAttr) addBoundaryQuadrics([&](int u, const Quadric& Q) { attrQuadrics[u].addGeometric(Q); });
+    else addBoundaryQuadrics([&](int u, const Quadric& Q) { uniqueVertices[u].q += Q; });
+}
+
 void MACSimplifier::runSimplification(double ratio) {
     if (indices.empty()) return;
 
     std::vector<std::vector<int>> vertFaces(uniqueVertices.size());
     int numFaces = uniqueIndices.size() / 3;
     for(int i=0; i<numFaces; ++i) {
+        if(i % kStopCheckInterval == 0 && shouldStop()) break;
         int i0=uniqueIndices[i*3], i1=uniqueIndices[i*3+1], i2=uniqueIndices[i*3+2];
         if(i0==i1||i1==i2||i2==i0) continue;
         vertFaces[i0].push_back(i); vertFaces[i1].push_back(i); vertFaces[i2].push_back(i);
     }
 
+    reportProgress("quadrics", 0.0);
     computeQuadrics();
+    reportProgress("quadrics", 1.0);
+
+    bool stopped = shouldStop();
 
     std::vector<Edge*> heap;
-    std::set<std::pair<int, int>> edgeSet;
+    std::unordered_set<int64_t> edgeSet;
 
     auto calc_cost = [&](int v1, int v2, const Quadric& Q, Vec3& target) -> double {
         double c_v1 = Q.evaluate(uniqueVertices[v1].p);
@@ -299,17 +603,67 @@ void MACSimplifier::runSimplification(double ratio) {
         return min_cost;
     };
 
+    // 属性感知版本：端点处属性取该位置下的最优值，最优点同时求解位置与属性
+    bool useAttr = useAttributeQuadrics();
+    // 属性路径分配的是 AttrEdge，释放时需按实际类型删除
+    auto delete_edge = [&](Edge* e) {
+        if(useAttr) delete static_cast<AttrEdge*>(e);
+        else delete e;
+    };
+    // 接缝顶点的二次型叠加了接缝两侧互不兼容的属性平面，不能用来求新位置：
+    // 涉及接缝顶点的边只能坍塌到接缝端点的原位置
+    auto calc_cost_attr = [&](int v1, int v2, const AttrQuadric& Q, Vec3& target, AttrVec& targetAttr) -> double {
+        bool seam1 = uniqueVertices[v1].seam;
+        bool seam2 = uniqueVertices[v2].seam;
+        AttrQuadric::Reduced R = Q.reduce();
+        AttrVec s1 = R.valid ? R.attributesAt(uniqueVertices[v1].p) : uniqueVertices[v1].attr;
+        AttrVec s2 = R.valid ? R.attributesAt(uniqueVertices[v2].p) : uniqueVertices[v2].attr;
+        double c_v1 = Q.evaluate(uniqueVertices[v1].p, s1);
+        double c_v2 = Q.evaluate(uniqueVertices[v2].p, s2);
+
+        bool use_v1 = seam1 || !seam2;
+        double min_cost = use_v1 ? c_v1 : c_v2;
+        target = use_v1 ? uniqueVertices[v1].p : uniqueVertices[v2].p;
+        targetAttr = use_v1 ? s1 : s2;
+
+        if (use_v1 && (seam2 || !seam1) && c_v2 < min_cost) {
+            min_cost = c_v2;
+            target = uniqueVertices[v2].p;
+            targetAttr = s2;
+        }
+        if (seam1 || seam2) return min_cost;
+
+        Vec3 p_opt;
+        AttrVec s_opt;
+        if (R.optimize(p_opt, s_opt)) {
+            double c_opt = Q.evaluate(p_opt, s_opt);
+            if (c_opt < min_cost * 0.8) {
+                double dist = (uniqueVertices[v1].p - uniqueVertices[v2].p).norm();
+                if ((p_opt - uniqueVertices[v1].p).norm() < dist * 1.5) {
+                    min_cost = c_opt;
+                    target = p_opt;
+                    targetAttr = s_opt;
+                }
+            }
+        }
+        return min_cost;
+    };
+
     for(int i=0; i<numFaces; ++i) {
+        if(i % kStopCheckInterval == 0 && shouldStop()) { stopped = true; break; }
         int idx[3] = {uniqueIndices[i*3], uniqueIndices[i*3+1], uniqueIndices[i*3+2]};
         if(idx[0]==idx[1]||idx[1]==idx[2]||idx[2]==idx[0]) continue;
         for(int j=0; j<3; ++j) {
             int v1=idx[j], v2=idx[(j+1)%3];
             if(v1>v2) std::swap(v1,v2);
-            if(edgeSet.find({v1,v2}) == edgeSet.end()) {
-                edgeSet.insert({v1,v2});
-                Edge* e = new Edge(); e->v1=v1; e->v2=v2;
-                Quadric Qbar = uniqueVertices[v1].q + uniqueVertices[v2].q;
-                e->cost = calc_cost(v1, v2, Qbar, e->target);
+            if(edgeSet.insert(edge_key(v1, v2)).second) {
+                Edge* e = useAttr ? new AttrEdge() : new Edge(); e->v1=v1; e->v2=v2;
+                if(useAttr) {
+                    e->cost = calc_cost_attr(v1, v2, attrQuadrics[v1] + attrQuadrics[v2], e->target, static_cast<AttrEdge*>(e)->targetAttr);
+                } else {
+                    Quadric Qbar = uniqueVertices[v1].q + uniqueVertices[v2].q;
+                    e->cost = calc_cost(v1, v2, Qbar, e->target);
+                }
                 heap.push_back(e);
             }
         }
@@ -324,13 +678,41 @@ void MACSimplifier::runSimplification(double ratio) {
     for(size_t i=0; i<map.size(); ++i) map[i]=i;
     auto get_root = [&](int id) { while(id!=map[id]){ map[id]=map[map[id]]; id=map[id]; } return id; };
 
-    while(currentFaces > targetFaces && !heap.empty()) {
+    // 预处理到此结束；预处理超时则放弃 QEM，由 simplify 回退到聚类
+    inSetup = false;
+    if (setupExpired) {
+        for(auto e: heap) delete_edge(e);
+        return;
+    }
+
+    reportProgress("collapse", 0.0);
+    std::vector<int> ring1, ring2, sharedFaces;
+    std::vector<int> vertVersion(useAttr ? uniqueVertices.size() : 0, 0);
+    int iteration = 0;
+    while(!stopped && currentFaces > targetFaces && !heap.empty()) {
+        if(++iteration % kStopCheckInterval == 0) {
+            if(shouldStop()) break;
+            reportProgress("collapse", (double)(numFaces - currentFaces) / std::max(1, numFaces - targetFaces));
+        }
         std::pop_heap(heap.begin(), heap.end(), [](Edge* a, Edge* b){ return a->cost > b->cost; });
         Edge* e = heap.back(); heap.pop_back();
 
         int r1 = get_root(e->v1);
         int r2 = get_root(e->v2);
-        if(r1==r2 || uniqueVertices[r1].removed || uniqueVertices[r2].removed) { delete e; continue; }
+        if(r1==r2 || uniqueVertices[r1].removed || uniqueVertices[r2].removed) { delete_edge(e); continue; }
+
+        // 属性路径：端点已被合并或移动过时，代价与目标 (尤其是接缝约束) 已经过期，按当前端点重新计算后放回堆中
+        if(useAttr) {
+            AttrEdge* ae = static_cast<AttrEdge*>(e);
+            if(r1 != e->v1 || r2 != e->v2 || ae->version1 != vertVersion[r1] || ae->version2 != vertVersion[r2]) {
+                e->v1 = r1; e->v2 = r2;
+                ae->version1 = vertVersion[r1]; ae->version2 = vertVersion[r2];
+                e->cost = calc_cost_attr(r1, r2, attrQuadrics[r1] + attrQuadrics[r2], e->target, ae->targetAttr);
+                heap.push_back(e);
+                std::push_heap(heap.begin(), heap.end(), [](Edge* a, Edge* b){ return a->cost > b->cost; });
+                continue;
+            }
+        }
 
         bool flip = false;
         auto check_flip_vert = [&](int u) {
@@ -354,25 +736,262 @@ void MACSimplifier::runSimplification(double ratio) {
         };
         if(check_flip_vert(r1) || check_flip_vert(r2)) flip = true;
 
+        // 链接条件：两端点的公共邻居数多于共享的面数时，坍塌会把两侧的面折叠成重复面
+        auto collect_neighbors = [&](int u, std::vector<int>& out) {
+            out.clear();
+            for(int fid : vertFaces[u]) {
+                int f[3] = {get_root(uniqueIndices[fid*3]), get_root(uniqueIndices[fid*3+1]), get_root(uniqueIndices[fid*3+2])};
+                if(f[0]==f[1]||f[1]==f[2]||f[2]==f[0]) continue;
+                if(f[0]!=u && f[1]!=u && f[2]!=u) continue;
+                for(int k=0; k<3; ++k) if(f[k]!=u) out.push_back(f[k]);
+            }
+            std::sort(out.begin(), out.end());
+            out.erase(std::unique(out.begin(), out.end()), out.end());
+        };
+        if(!flip) {
+            collect_neighbors(r1, ring1);
+            collect_neighbors(r2, ring2);
+            int common = 0, shared = 0;
+            for(int v : ring1) if(v != r2 && std::binary_search(ring2.begin(), ring2.end(), v)) common++;
+            sharedFaces.clear();
+            for(int fid : vertFaces[r1]) {
+                int f[3] = {get_root(uniqueIndices[fid*3]), get_root(uniqueIndices[fid*3+1]), get_root(uniqueIndices[fid*3+2])};
+                if(f[0]==f[1]||f[1]==f[2]||f[2]==f[0]) continue;
+                if((f[0]==r1||f[1]==r1||f[2]==r1) && (f[0]==r2||f[1]==r2||f[2]==r2)) sharedFaces.push_back(fid);
+            }
+            std::sort(sharedFaces.begin(), sharedFaces.end());
+            shared = (int)(std::unique(sharedFaces.begin(), sharedFaces.end()) - sharedFaces.begin());
+            if(common > shared) flip = true;
+        }
+
         if(!flip) {
             uniqueVertices[r1].p = e->target;
-            uniqueVertices[r1].q += uniqueVertices[r2].q;
+            if(useAttr) {
+                vertVersion[r1]++;
+                attrQuadrics[r1] += attrQuadrics[r2];
+                uniqueVertices[r1].attr = static_cast<AttrEdge*>(e)->targetAttr;
+                uniqueVertices[r1].seam = uniqueVertices[r1].seam || uniqueVertices[r2].seam;
+            } else {
+                uniqueVertices[r1].q += uniqueVertices[r2].q;
+            }
             uniqueVertices[r2].removed = true;
             map[r2] = r1;
             if(vertFaces[r1].size() < 200) vertFaces[r1].insert(vertFaces[r1].end(), vertFaces[r2].begin(), vertFaces[r2].end());
             currentFaces -= 2;
         }
-        delete e;
+        delete_edge(e);
     }
+    reportProgress("collapse", currentFaces <= targetFaces ? 1.0 : (double)(numFaces - currentFaces) / std::max(1, numFaces - targetFaces));
 
     for(size_t i=0; i<uniqueVertices.size(); ++i) {
         int root = get_root(i);
         Vec3 pos = uniqueVertices[root].p;
+        // 非接缝顶点使用坍塌时求得的最优法线与 UV；接缝顶点保留各原始顶点自身的属性；
+        // 并入接缝顶点的非接缝顶点取接缝处属性最接近的那个原始顶点的属性，保证与所在一侧一致
+        bool seamRoot = uniqueVertices[root].seam;
+        bool writeAttr = useAttr && !(seamRoot && (int)i == root);
         for(int oldIdx : uniqueVertices[i].originalIndices) {
             vertices[oldIdx].p = pos;
+            if(!writeAttr) continue;
+
+            AttrVec attr = uniqueVertices[root].attr;
+            if(seamRoot) {
+                // 并入接缝顶点：取接缝处与本顶点属性最接近的原始顶点属性，保证位于接缝的同一侧
+                AttrVec own = uniqueVertices[i].seam ? wedgeAttr(oldIdx) : uniqueVertices[i].attr;
+                double best = std::numeric_limits<double>::max();
+                for(int w : uniqueVertices[root].originalIndices) {
+                    AttrVec cand = wedgeAttr(w);
+                    double d = (cand - own).squaredNorm();
+                    if(d < best) { best = d; attr = cand; }
+                }
+            }
+            Vec3 n = attr.head<3>();
+            if(n.norm() < 1e-12) continue;
+            normals[oldIdx] = n.normalized();
+            uvs[oldIdx] = attr.tail<2>();
+        }
+    }
+
+    // 属性路径下同一网格中位置与属性都相同的原始顶点合并为一个，避免写回时产生大量重复顶点
+    if(useAttr) {
+        std::vector<int> meshBase;
+        for(const auto& ref : meshGroups) meshBase.push_back(ref.baseVertexIdx);
+        std::unordered_map<long long, std::vector<int>> reps;
+        std::vector<int> gidRep(vertices.size());
+        for(size_t gid=0; gid<vertices.size(); ++gid) {
+            int root = get_root(vertices[gid].uniqueId);
+            int group = (int)(std::upper_bound(meshBase.begin(), meshBase.end(), (int)gid) - meshBase.begin()) - 1;
+            std::vector<int>& cands = reps[(long long)root * meshGroups.size() + group];
+            gidRep[gid] = (int)gid;
+            for(int c : cands) {
+                if((normals[c] - normals[gid]).squaredNorm() < 1e-20 && (uvs[c] - uvs[gid]).squaredNorm() < 1e-20) { gidRep[gid] = c; break; }
+            }
+            if(gidRep[gid] == (int)gid) cands.push_back((int)gid);
+        }
+        for(auto& idx : indices) idx = gidRep[idx];
+    }
+    for(auto e: heap) delete_edge(e);
+}
+
+void MACSimplifier::runClustering(double ratio) {
+    if (indices.empty()) return;
+    if (shouldStop()) return;
+
+    std::cout << "[Info] Running Vertex Clustering..." << std::endl;
+    reportProgress("cluster", 0.0);
+
+    int numVerts = (int)vertices.size();
+    int numFaces = (int)(indices.size() / 3);
+
+    // 包围盒与总面积 (每线程局部结果，最后合并)
+    int vertWorkers = parallel_workers(numVerts);
+    std::vector<Vec3> localMin(vertWorkers, vertices[0].p), localMax(vertWorkers, vertices[0].p);
+    parallel_for(numVerts, [&](int w, int begin, int end) {
+        for (int i = begin; i < end; ++i) {
+            localMin[w] = localMin[w].cwiseMin(vertices[i].p);
+            localMax[w] = localMax[w].cwiseMax(vertices[i].p);
         }
+    });
+    Vec3 bmin = localMin[0], bmax = localMax[0];
+    for (int w = 1; w < vertWorkers; ++w) { bmin = bmin.cwiseMin(localMin[w]); bmax = bmax.cwiseMax(localMax[w]); }
+    double extent = (bmax - bmin).maxCoeff();
+    if (extent < 1e-12) return;
+
+    // 正方体格子，每轴最多 2^21 格，三轴坐标各占 21 位，可以打包进一个 int64
+    const int maxRes = 1 << 21;
+    int res = clusterGridResolution;
+    if (res <= 0) {
+        // 自适应分辨率：输出面数约为被占用格子数的 2 倍，按目标面数反推格子数。
+        // 表面穿过的格子数约为 各面在三个轴向上投影面积之和 / 格子边长^2
+        int faceWorkers = parallel_workers(numFaces);
+        std::vector<double> localArea(faceWorkers, 0.0);
+        parallel_for(numFaces, [&](int w, int begin, int end) {
+            for (int f = begin; f < end; ++f) {
+                const Vec3& p0 = vertices[indices[f * 3]].p;
+                localArea[w] += 0.5 * (vertices[indices[f * 3 + 1]].p - p0).cross(vertices[indices[f * 3 + 2]].p - p0).lpNorm<1>();
+            }
+        });
+        double area = 0.0;
+        for (double a : localArea) area += a;
+
+        int targetCells = std::max(4, (int)(numFaces * (1.0 - ratio) / 2));
+        double cell = std::sqrt(area / targetCells);
+        res = cell > 0.0 ? (int)std::min<double>(maxRes, std::ceil(extent / cell)) : 1;
     }
-    for(auto e: heap) delete e;
+    res = std::max(1, std::min(res, maxRes));
+    double cellSize = extent / res;
+    std::cout << "[Info] Cluster Grid Resolution: " << res << std::endl;
+
+    std::vector<int64_t> cellKeys(numVerts);
+    parallel_for(numVerts, [&](int, int begin, int end) {
+        double inv = 1.0 / cellSize;
+        for (int i = begin; i < end; ++i) {
+            Vec3 c = (vertices[i].p - bmin) * inv;
+            int64_t cx = std::min<int64_t>((int64_t)c.x(), res - 1);
+            int64_t cy = std::min<int64_t>((int64_t)c.y(), res - 1);
+            int64_t cz = std::min<int64_t>((int64_t)c.z(), res - 1);
+            cellKeys[i] = (cx << 42) | (cy << 21) | cz;
+        }
+    });
+    if (shouldStop()) return;
+
+    // 分配聚类编号并累加坐标 (用于退化时的均值点)
+    std::unordered_map<int64_t, int> cellToCluster;
+    cellToCluster.reserve(numVerts);
+    std::vector<int> clusterOf(numVerts);
+    std::vector<int64_t> clusterKey;
+    std::vector<Vec3> clusterSum;
+    std::vector<int> clusterCount;
+    for (int i = 0; i < numVerts; ++i) {
+        auto it = cellToCluster.find(cellKeys[i]);
+        int cid;
+        if (it != cellToCluster.end()) {
+            cid = it->second;
+        } else {
+            cid = (int)clusterKey.size();
+            cellToCluster.emplace(cellKeys[i], cid);
+            clusterKey.push_back(cellKeys[i]);
+            clusterSum.push_back(Vec3::Zero());
+            clusterCount.push_back(0);
+        }
+        clusterOf[i] = cid;
+        clusterSum[cid] += vertices[i].p;
+        clusterCount[cid]++;
+    }
+    int numClusters = (int)clusterKey.size();
+    if (shouldStop()) return;
+
+    // 单遍扫描所有面：面平面二次误差直接累加到三个角点所在的聚类。
+    // 每个线程写自己的压缩累加器 (10 个 double)，由线程自己分配清零，结束后按聚类区间并行合并；
+    // 聚类很多时限制线程数，使每线程累加器的总内存不超过 kMaxLocalBytes
+    const size_t kMaxLocalBytes = size_t(256) << 20;
+    size_t perWorkerBytes = std::max<size_t>(1, (size_t)numClusters * sizeof(PackedQuadric));
+    int faceWorkers = parallel_workers(numFaces, (int)std::max<size_t>(1, kMaxLocalBytes / perWorkerBytes));
+    std::vector<std::vector<PackedQuadric>> localQ(faceWorkers);
+    parallel_for(numFaces, [&](int w, int begin, int end) {
+        std::vector<PackedQuadric>& acc = localQ[w];
+        acc.assign(numClusters, PackedQuadric());
+        for (int f = begin; f < end; ++f) {
+            int i0 = indices[f * 3], i1 = indices[f * 3 + 1], i2 = indices[f * 3 + 2];
+            const Vec3& p0 = vertices[i0].p;
+            Vec3 crossP = (vertices[i1].p - p0).cross(vertices[i2].p - p0);
+            if (crossP.norm() < 1e-12) continue;
+
+            Vec3 n = crossP.normalized();
+            PackedQuadric Kp = PackedQuadric::FromPlane(n, -n.dot(p0), w_geo);
+            acc[clusterOf[i0]] += Kp;
+            acc[clusterOf[i1]] += Kp;
+            acc[clusterOf[i2]] += Kp;
+        }
+    }, faceWorkers);
+    std::vector<Quadric> clusterQ(numClusters);
+    parallel_for(numClusters, [&](int, int begin, int end) {
+        for (int c = begin; c < end; ++c) {
+            PackedQuadric sum;
+            for (const auto& acc : localQ) if (!acc.empty()) sum += acc[c];
+            clusterQ[c] = sum.toQuadric();
+        }
+    });
+    localQ.clear();
+    localQ.shrink_to_fit();
+    if (shouldStop()) return;
+
+    // 可选：边界保护需要焊接拓扑来识别只属于一个面的边，代价远高于聚类本身
+    if (clusterPreserveBoundary) {
+        buildUniqueTopology();
+        if (shouldStop()) return;
+        addBoundaryQuadrics([&](int u, const Quadric& Q) {
+            clusterQ[clusterOf[uniqueVertices[u].originalIndices[0]]] += Q;
+        });
+        if (shouldStop()) return;
+    }
+
+    // 求解每个聚类的代表点，超出所在格子 (各方向放宽半格) 则退化为均值点
+    std::vector<Vec3> clusterPos(numClusters);
+    parallel_for(numClusters, [&](int, int begin, int end) {
+        const int64_t mask = (1 << 21) - 1;
+        for (int c = begin; c < end; ++c) {
+            Vec3 mean = clusterSum[c] / clusterCount[c];
+            Vec3 cellMin = bmin + Vec3((double)(clusterKey[c] >> 42),
+                                       (double)((clusterKey[c] >> 21) & mask),
+                                       (double)(clusterKey[c] & mask)) * cellSize;
+            Vec3 lo = cellMin - Vec3::Constant(0.5 * cellSize);
+            Vec3 hi = cellMin + Vec3::Constant(1.5 * cellSize);
+            Vec3 p_opt;
+            if (clusterQ[c].optimize(p_opt) && (p_opt.array() >= lo.array()).all() && (p_opt.array() <= hi.array()).all()) {
+                clusterPos[c] = p_opt;
+            } else {
+                clusterPos[c] = mean;
+            }
+        }
+    });
+
+    parallel_for(numVerts, [&](int, int begin, int end) {
+        for (int i = begin; i < end; ++i) vertices[i].p = clusterPos[clusterOf[i]];
+    });
+
+    reportProgress("cluster", 1.0);
+    std::cout << "[Info] Clustered Vertices: " << numVerts << " -> " << numClusters << std::endl;
 }
 
 void MACSimplifier::writeBack(const aiScene* scene) {
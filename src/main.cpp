@@ -11,7 +11,7 @@ namespace fs = std::filesystem;
 
 int main(int argc, char** argv) {
     if (argc < 3) {
-        std::cout << "Usage: MACSimplifier <input> <output> <ratio> [w_norm] [w_uv] [w_boundary]" << std::endl;
+        std::cout << "Usage: MACSimplifier <input> <output> <ratio> [w_norm] [w_uv] [w_boundary] [engine: qem|cluster|cluster_boundary] [time_budget_sec]" << std::endl;
         return 1;
     }
 
@@ -24,11 +24,37 @@ int main(int argc, char** argv) {
     if (argc >= 5) simplifier.w_norm = std::stof(argv[4]);
     if (argc >= 6) simplifier.w_uv_base = std::stof(argv[5]);
     if (argc >= 7) simplifier.w_boundary = std::stof(argv[6]);
+    if (argc >= 8) {
+        std::string engineStr = argv[7];
+        if (engineStr == "cluster" || engineStr == "cluster_boundary") {
+            simplifier.engine = SimplifyEngine::Clustering;
+            simplifier.clusterPreserveBoundary = (engineStr == "cluster_boundary");
+        } else if (engineStr != "qem") {
+            std::cout << "[Error] Unknown engine: " << engineStr << " (expected qem, cluster or cluster_boundary)" << std::endl;
+            return 1;
+        }
+    }
+    if (argc >= 9) simplifier.timeBudgetSeconds = std::stod(argv[8]);
 
     std::cout << "[App] Settings:" << std::endl;
     std::cout << "      Input:  " << inputPathStr << std::endl;
     std::cout << "      Output: " << outputPathStr << std::endl;
     std::cout << "      Ratio:  " << ratio << std::endl;
+    std::cout << "      Engine: " << (simplifier.engine == SimplifyEngine::Clustering ? "cluster" : "qem") << std::endl;
+    if (simplifier.timeBudgetSeconds > 0.0) {
+        std::cout << "      Budget: " << simplifier.timeBudgetSeconds << "s (load and write-back are not interruptible)" << std::endl;
+    }
+
+    // 每个阶段按 10% 步进打印进度
+    std::string lastPhase;
+    int lastStep = -1;
+    simplifier.onProgress = [&](const std::string& phase, double fraction) {
+        int step = (int)(fraction * 10.0);
+        if (phase == lastPhase && step == lastStep) return;
+        lastPhase = phase;
+        lastStep = step;
+        std::cout << "[App] Progress: " << phase << " " << step * 10 << "%" << std::endl;
+    };
 
     // --- Assimp Load ---
     Assimp::Importer importer;
@@ -51,6 +77,8 @@ int main(int argc, char** argv) {
 
     // --- Simplify ---
     simplifier.simplify(scene, ratio);
+    std::cout << "[App] Achieved Ratio: " << simplifier.getAchievedRatio()
+              << (simplifier.wasInterrupted() ? " (stopped early)" : "") << std::endl;
 
     // --- Texture Copying ---
     std::cout << "[App] Processing textures..." << std::endl;